@@ -6,7 +6,11 @@
 #include <cmath>
 #include <numeric>
 #include <functional>
+#include <atomic>
+#include <cstring>
 #include <caf/all.hpp>
+#include "placement.hpp"
+#include "utility.hpp"
 
 #define DEBUG(arg) std::cout << #arg "\t" << (arg) << std::endl ;
 #define D(arg) arg
@@ -148,18 +152,27 @@ private:
 } ;
 UInt Market::serial_number_ = 0 ;
 
-class Household : public Household_t::base {
+// Serial numbers are shared by the households of all the utility families.
+class HouseholdBase : public Household_t::base {
+protected :
+	// Households may be constructed from several threads, one per NUMA node.
+	static atomic<UInt> serial_number_ ;
+} ;
+atomic<UInt> HouseholdBase::serial_number_{0} ;
+
+// An household whose preferences belong to the utility family “U”.
+template <class U>
+class Household : public HouseholdBase {
 public :
-	static UInt serial_number_ ;
-	Household(const vector<float> & alphas, const vector<float> & endowments)
+	Household(const vector<float> & params, const vector<float> & endowments)
 	   : id_(serial_number_++)
-	   , alphas_(alphas)
+	   , params_(params)
 	   , endowments_(endowments)
 	   , check_(0)
 	   , nr_received_prices_(0)
-	   , prices_(alphas.size())
+	   , prices_(endowments.size())
 	   {
-		assert( alphas.size() == endowments.size() ) ;
+		assert( params.size() == U::nr_params*endowments.size() ) ;
 		D(caf::aout(this) << "Constructing household #" << id_ << endl ;) }
 protected :
 	behavior_type make_behavior() override {
@@ -170,7 +183,7 @@ protected :
 	}
 private:
 	const UInt id_ ;
-	const vector<float> alphas_ ;
+	const vector<float> params_ ;
 	const vector<float> endowments_ ;
 	size_t check_ ;
 	UInt nr_received_prices_ ;
@@ -188,19 +201,9 @@ private:
 		D(caf::aout(this) << "Household #" << id_ << " doing optimisation..." << endl ;)
 		// A simple way to partially check that each market sent a price.
 		assert ( check_ == ((prices_.size()-1)*prices_.size()/2) ) ;
-		const auto M = prices_.size() ;
-		constexpr auto sig = 2. ;
-		// First term to compute the general level of prices for this household.
-		const auto sum = inner_product( RANGE(prices_), alphas_.begin(), 0.,
-			 plus<double>(), [=] (double p, double alpha) { return pow(alpha, sig) * pow(p, 1.-sig) ; } ) ;
-		// General level of prices for this household.
-		const auto P = pow(sum, 1./(1.-sig)) ;
-		// Value of initial endowment, i.e. revenu of consummer.
-		const auto R = inner_product(RANGE(prices_), endowments_.begin(), 0.) ;
-		for ( UInt m = 0 ; m <= M ; ++ m ) {
-			const auto q = pow(alphas_[m], sig) * pow(prices_[m]/P, -sig) * R/P - endowments_[m] ;
+		U::demand(prices_.data(), params_.data(), endowments_.data(), prices_.size(), [&](UInt m, double q) {
 			send(markets[m], quant_a::value, id_, q) ;
-		}
+		}) ;
 		check_ = nr_received_prices_ = 0 ;
 	}
 	void do_stop() {
@@ -208,7 +211,20 @@ private:
 		quit() ;
 	}
 } ;
-UInt Household::serial_number_ = 0 ;
+
+template <class U>
+Household_t spawn_household_of(const vector<float> & params, const vector<float> & endowments) {
+	return caf::spawn_typed<Household<U>>(params, endowments) ;
+}
+
+// Spawning function for each utility family.
+Household_t (* const spawn_household[utility::nr_families])(const vector<float> &, const vector<float> &) = {
+	  spawn_household_of<utility::CES>
+	, spawn_household_of<utility::CobbDouglas>
+	, spawn_household_of<utility::Leontief>
+	, spawn_household_of<utility::NestedCES>
+	, spawn_household_of<utility::StoneGeary>
+} ;
 
 // This actor sends the start signal to each market and deads.
 void start(caf::event_based_actor * self) {
@@ -217,7 +233,32 @@ void start(caf::event_based_actor * self) {
 	self->quit() ;
 }
 
-int main() {
+int main(int argc, char * argv[]) {
+
+	// With “--families ces,leontief”, households are split evenly among the listed utility
+	// families (ces, cobb-douglas, leontief, nested-ces, stone-geary) ; a population mostly made of
+	// leontief households does not converge.
+	placement::Options place ;
+	vector<utility::Family> families{utility::ces} ;
+	for ( int a = 1 ; a < argc ; ++ a ) {
+		if ( placement::parse_option(a, argc, argv, place) ) continue ;
+		if ( ! strcmp(argv[a], "--families") && a+1 < argc ) families = utility::parse_families(argv[++a]) ;
+		else {
+			cerr << "usage: " << argv[0] << " [--families ces,cobb-douglas,leontief,nested-ces,stone-geary] " <<
+			   placement::usage << endl << utility::families_note << endl ;
+			return 1 ;
+		}
+	}
+	if ( families.empty() ) {
+		cerr << "Unknown utility family" << endl ;
+		return 1 ;
+	}
+	if ( ! placement::valid(place) )
+		return 1 ;
+
+	placement::start_scheduler(place) ;
+	// The supervisor and the markets live on the first node.
+	placement::bind_to_first_node(place) ;
 
 	//~ constexpr UInt M = 100 ;
 	//~ constexpr UInt H = 10*1000 ;
@@ -225,28 +266,33 @@ int main() {
 	constexpr UInt H = 3 ;
 
 	default_random_engine rng ;
-	uniform_real_distribution<double> ran_uni ;
 
 	// Spawn the supervisor.
 	supervisor = caf::spawn_typed<Supervisor>(M) ;
 
-	households.reserve(H) ;
 	markets.reserve(M) ;
 
-	for ( size_t h = 0 ; h < H ; ++ h ) {
+	// Households are grouped by utility family.
+	vector<utility::Family> family(H) ;
+	vector<vector<float>> params(H), endowments(H) ;
+	for ( size_t g = 0 ; g < families.size() ; ++ g )
+		for ( auto h = utility::group_begin(g, H, families.size()) ;
+		      h < utility::group_begin(g+1, H, families.size()) ; ++ h ) {
 
-		// Set up the 𝛼 parameter for each good.
-		vector<float> alphas ; alphas.reserve(M) ;
-		for ( UInt m = 0 ; m < M ; ++ m )
-			alphas.emplace_back(ran_uni(rng)) ;
+			// Set up the parameters (the 𝛼 for each good for the CES family).
+			family[h] = families[g] ;
+			params[h] = utility::draw(family[h], rng, M) ;
 
-		// Set up the initial endowment for each good.
-		vector<float> endowments ; endowments.reserve(M) ;
-		for ( UInt m = 0 ; m < M ; ++ m )
-			endowments.emplace_back(100*ran_uni(rng)) ;
+			// Set up the initial endowment for each good.
+			endowments[h] = utility::draw_uniform(rng, M, 100.) ;
+		}
 
-		households.emplace_back(caf::spawn_typed<Household>(alphas, endowments)) ;
-	}
+	// The households copy their parameters on the NUMA node of the thread constructing them.
+	households.resize(H) ;
+	placement::for_each_slice(place, H, [&](size_t begin, size_t end) {
+		for ( auto h = begin ; h < end ; ++ h )
+			households[h] = spawn_household[family[h]](params[h], endowments[h]) ;
+	}) ;
 
 	for ( size_t m = 0 ; m < M ; ++ m )
 		markets.emplace_back(caf::spawn_typed<Market>(H)) ;
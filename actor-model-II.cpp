@@ -6,7 +6,15 @@
 #include <cmath>
 #include <numeric>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
 #include <caf/all.hpp>
+#include "wire.hpp"
+#include "placement.hpp"
+#include "utility.hpp"
 
 #define DEBUG(arg) std::cout << #arg "\t" << (arg) << std::endl ;
 //~ #define D(arg) arg
@@ -17,44 +25,88 @@ using namespace std ;
 
 typedef unsigned int UInt ; 
 
-// Message about prices : sent by the supervisor and received by households.
-using price_a = caf::atom_constant<caf::atom("PRICE")>;
-// Message about quantity : sent by an household and received by a market.
-using quant_a = caf::atom_constant<caf::atom("QUANT")>;
-// Message about price and relative excess demande : sent by a market and received by the supervisor.
-using pred_a = caf::atom_constant<caf::atom("PRED")> ;
+// The messages about prices (PriceMsg), quantity (QuantMsg) and price and relative excess demand
+// (PredMsg) are declared in wire.hpp with their compact serializers.
 // Message received by an household or by a market to stop.
 using stop_a = caf::atom_constant<caf::atom("STOP")>;
+// Message about credit : sent by a market to the supervisor each time it has drained a batch of
+// quantities from its mailbox, with flow control only.
+using credit_a = caf::atom_constant<caf::atom("CREDIT")>;
+// Message about shock : sent by the supervisor to an household between two periods, with the
+// seed of the drift of its parameters and endowment and the size of the drift.
+using shock_a = caf::atom_constant<caf::atom("SHOCK")>;
+// Message received by a market to reset its price to 1 at the beginning of a period.
+using reset_a = caf::atom_constant<caf::atom("RESET")>;
 
 // A market receives
 //  * a message from an household with a quantity ;
+//  * a message from the supervisor to reset its price ;
 //  * a message from the supervisor to stop.
 using MarketAddr = caf::typed_actor<
-     caf::replies_to<quant_a, UInt, double>::with<void>
+     caf::replies_to<QuantMsg>::with<void>
+   , caf::replies_to<reset_a>::with<void>
    , caf::replies_to<stop_a>::with<void>
 > ;
 
 // An household receives
 //  * a message from the supervisor with a vector of prices ;
+//  * a message from the supervisor with a shock ;
 //  * a message from the supervisor to stop.
 using HouseholdAddr = caf::typed_actor<
-     caf::replies_to<price_a, vector<double>>::with<void>
+     caf::replies_to<PriceMsg>::with<void>
+   , caf::replies_to<shock_a, UInt, double>::with<void>
    , caf::replies_to<stop_a>::with<void>
 > ;
 
 // The supervisor receives
-//  * a message from a market with the price and the relative excess demand.
+//  * a message from a market with the price and the relative excess demand ;
+//  * a message from a market with a credit.
 using SupervisorAddr = caf::typed_actor<
-   caf::replies_to<pred_a, UInt, double, double>::with<void>
+     caf::replies_to<PredMsg>::with<void>
+   , caf::replies_to<credit_a, UInt>::with<void>
 > ;
 
+// Flow control of the broadcast of prices. Without it, the supervisor sends the prices to all
+// households in one burst and the H×M quantities pile up in the mailboxes of the markets. With
+// it, the households whose quantities the slowest market has not drained yet, as known from the
+// credits returned by the markets, are bounded by a window: a wave of households leaves each
+// time the slowest market frees room in it.
+struct FlowControl {
+	bool on ;
+	// A market returns a credit each time it has drained “batch” quantities.
+	UInt batch ;
+	// Upper bound of the window.
+	UInt target ;
+} ;
+
+// Sequence of periods. Between two periods, each household is shocked with probability “share”:
+// its parameters and endowment drift by at most “size” in relative terms. The tâtonnement of a
+// period starts from the equilibrium prices of the previous one, unless “cold_start”.
+struct Periods {
+	UInt T ;
+	double share ;
+	double size ;
+	bool cold_start ;
+} ;
+
+// Number of quantities waiting in the mailbox of each market: an household counts a quantity
+// before sending it, the market uncounts it when handling it. The counters are shared by the
+// actors of this process, where all the markets live.
+typedef atomic<UInt> MailboxDepth ;
+
+// Approximate memory held by a quantity waiting in a mailbox.
+constexpr size_t queued_quantity_size = sizeof(caf::mailbox_element) + sizeof(caf::detail::tuple_vals<QuantMsg>) ;
+
 class Market : public MarketAddr::base {
 public:
 	static UInt serial_number_ ;
-	Market(UInt H, SupervisorAddr supervisor)
+	// “batch” is 0 without flow control.
+	Market(UInt H, SupervisorAddr supervisor, UInt batch, MailboxDepth * depths)
 	   : id_(serial_number_++)
 	   , H_(H)
 	   , supervisor_(supervisor)
+	   , batch_(batch)
+	   , depth_(depths[id_])
 	   , p_(1.)
 	   {
 		D(caf::aout(this) << "Constructing market #" << id_ << endl ;)
@@ -63,7 +115,8 @@ public:
 protected:
 	behavior_type make_behavior() override {
 		return { 
-			  [&](quant_a, UInt h, double q) { do_receive_quantity(h, q) ; }
+			  [&](const QuantMsg & msg) { do_receive_quantity(msg.h, msg.q) ; }
+			, [&](reset_a) { p_ = 1. ; }
 			, [&](stop_a) { do_stop() ; }
 		} ;
 	}
@@ -71,14 +124,23 @@ private:
 	const UInt id_ ;
 	const UInt H_ ;
 	const SupervisorAddr supervisor_ ;
+	const UInt batch_ ;
+	MailboxDepth & depth_ ;
 	double p_ ;
 	size_t check_ ;
 	UInt nr_received_quantities_ ;
+	// Peak number of quantities in the mailbox during the iteration.
+	UInt max_depth_ ;
 	double supply_, demand_ ;
 	void do_receive_quantity(UInt h, double q) {
 		D(caf::aout(this) << "Market #" << id_ << " receives quantity " << q << " from household #" << h << endl ;)
+		// The mailbox held this quantity and the ones behind it.
+		max_depth_ = max(max_depth_, depth_.fetch_sub(1, memory_order_relaxed)) ;
 		((q < 0) ? supply_ : demand_) += q ;
-		if ( ++ nr_received_quantities_ == H_ )
+		++ nr_received_quantities_ ;
+		if ( batch_ && nr_received_quantities_ % batch_ == 0 )
+			send(supervisor_, credit_a::value, id_) ;
+		if ( nr_received_quantities_ == H_ )
 			do_price_update() ;
 	}
 	void do_price_update() {
@@ -86,7 +148,7 @@ private:
 		// Supply is accounted negatively.
 		const auto red = (demand_ + supply_) / ((-supply_+demand_)/2) ;
 		p_ *= (1.+.25*red) ;
-		send(supervisor_, pred_a::value, id_, p_, red) ;
+		send(supervisor_, PredMsg{id_, p_, red, max_depth_}) ;
 		iteration_init() ;
 	}
 	void do_stop() {
@@ -94,168 +156,372 @@ private:
 		quit() ;
 	}
 	void iteration_init() {
-		nr_received_quantities_ = 0 ;
+		nr_received_quantities_ = max_depth_ = 0 ;
 		supply_ = demand_ = 0. ;
 	}
 } ;
 UInt Market::serial_number_ = 0 ;
 
-class Household : public HouseholdAddr::base {
+// Serial numbers are shared by the households of all the utility families.
+class HouseholdBase : public HouseholdAddr::base {
+protected :
+	// Households may be constructed from several threads, one per NUMA node.
+	static atomic<UInt> serial_number_ ;
+} ;
+atomic<UInt> HouseholdBase::serial_number_{0} ;
+
+// An household whose preferences belong to the utility family “U”.
+template <class U>
+class Household : public HouseholdBase {
 public :
-	static UInt serial_number_ ;
 	Household(
-	     const vector<float> & alphas
+	     const vector<float> & params
 	   , const vector<float> & endowments
 	   , const vector<MarketAddr> & markets
+	   , bool f32
+	   , MailboxDepth * depths
 	   )
 	   : id_(serial_number_++)
-	   , alphas_(alphas)
+	   , params_(params)
 	   , endowments_(endowments)
 	   , markets_(markets)
+	   , f32_(f32)
+	   , depths_(depths)
+	   , prices_(markets.size(), 0.)
 	   {
-		assert( alphas.size() == endowments.size() ) ;
-		assert( alphas.size() == markets.size() ) ;
+		assert( params.size() == U::nr_params*endowments.size() ) ;
+		assert( endowments.size() == markets.size() ) ;
 		D(caf::aout(this) << "Constructing household #" << id_ << endl ;) }
 protected :
 	behavior_type make_behavior() override {
 		return { 
-			  [&](price_a, const vector<double> & prices) { do_receive_price(prices) ; }
+			  [&](const PriceMsg & msg) { do_receive_price(msg) ; }
+			, [&](shock_a, UInt seed, double size) { do_shock(seed, size) ; }
 			, [&](stop_a) { do_stop() ; }
 		} ;
 	}
 private:
 	const UInt id_ ;
-	const vector<float> alphas_ ;
-	const vector<float> endowments_ ;
+	vector<float> params_ ;
+	vector<float> endowments_ ;
 	const vector<MarketAddr> markets_ ;
+	const bool f32_ ;
+	MailboxDepth * const depths_ ;
+	// Prices rebuilt from the deltas received since the beginning.
+	vector<double> prices_ ;
 
-	void do_receive_price(const vector<double> & prices) {
-		D(caf::aout(this) << "Household #" << id_ << " receives prices " << *prices.begin() <<
-		   " ... " << *prices.rbegin() << endl ;)
-		const auto M = prices.size() ;
-		assert ( M == alphas_.size() ) ;
-		constexpr auto sig = 2. ;
-		// First term to compute the general level of prices for this household.
-		const auto sum = inner_product( RANGE(prices), alphas_.begin(), 0.,
-			 plus<double>(), [=] (double p, double alpha) { return pow(alpha, sig) * pow(p, 1.-sig) ; } ) ;
-		// General level of prices for this household.
-		const auto P = pow(sum, 1./(1.-sig)) ;
-		// Value of initial endowment, i.e. revenu of consummer.
-		const auto R = inner_product(RANGE(prices), endowments_.begin(), 0.) ;
-		for ( UInt m = 0 ; m < M ; ++ m ) {
-			const auto q = pow(alphas_[m], sig) * pow(prices[m]/P, -sig) * R/P - endowments_[m] ;
+	void do_receive_price(const PriceMsg & msg) {
+		const auto M = prices_.size() ;
+		assert ( M == msg.deltas.size() ) ;
+		for ( UInt m = 0 ; m < M ; ++ m )
+			prices_[m] += msg.deltas[m] ;
+		D(caf::aout(this) << "Household #" << id_ << " receives prices " << *prices_.begin() <<
+		   " ... " << *prices_.rbegin() << endl ;)
+		U::demand(prices_.data(), params_.data(), endowments_.data(), M, [&](UInt m, double q) {
 			D(caf::aout(this) << "Household #" << id_ << " sends quantity " << q <<
 			   " to market # " << m << endl ;)
-			send(markets_[m], quant_a::value, id_, q) ;
-		}
+			depths_[m].fetch_add(1, memory_order_relaxed) ;
+			// Narrowed in process, so that local and remote markets get the same quantity.
+			send(markets_[m], QuantMsg{f32_, id_, f32_ ? static_cast<float>(q) : q}) ;
+		}) ;
+	}
+	void do_shock(UInt seed, double size) {
+		D(caf::aout(this) << "Household #" << id_ << " receives a shock of size " << size << endl ;)
+		default_random_engine rng(seed) ;
+		utility::drift(rng, size, params_.data(), params_.size()) ;
+		utility::drift(rng, size, endowments_.data(), endowments_.size()) ;
 	}
 	void do_stop() {
 		D(caf::aout(this) << "Household #" << id_ << " receives the stop signal..." << endl ;)
 		quit() ;
 	}
 } ;
-UInt Household::serial_number_ = 0 ;
+
+template <class U>
+HouseholdAddr spawn_household_of(
+     const vector<float> & params
+   , const vector<float> & endowments
+   , const vector<MarketAddr> & markets
+   , bool f32
+   , MailboxDepth * depths
+   ) {
+	return caf::spawn_typed<Household<U>>(params, endowments, markets, f32, depths) ;
+}
+
+// Spawning function for each utility family.
+HouseholdAddr (* const spawn_household[utility::nr_families])(
+   const vector<float> &, const vector<float> &, const vector<MarketAddr> &, bool, MailboxDepth *) = {
+	  spawn_household_of<utility::CES>
+	, spawn_household_of<utility::CobbDouglas>
+	, spawn_household_of<utility::Leontief>
+	, spawn_household_of<utility::NestedCES>
+	, spawn_household_of<utility::StoneGeary>
+} ;
 
 class Supervisor : public SupervisorAddr::base {
 public :
-	Supervisor(UInt M, UInt H)
+	Supervisor(
+	     UInt M
+	   , UInt H
+	   , bool f32
+	   , FlowControl flow
+	   , const placement::Options & place
+	   , const vector<utility::Family> & families
+	   , Periods periods
+	   , MailboxDepth * depths
+	   )
 	   : M_(M)
 	   , H_(H)
+	   , f32_(f32)
+	   , flow_(flow)
+	   , periods_(periods)
+	   , t_(0)
+	   , window_(max(flow.target/2, flow.batch))
 		{
 		D(caf::aout(this) << "Constructing supervisor" << endl ;)
 
 		default_random_engine rng ;
-		uniform_real_distribution<double> ran_uni ;
 
 		const auto supervisor_address = address() ;
 
 		// Spawn all the markets in this economy.
 		markets_.reserve(M_) ;
 		for ( size_t m = 0 ; m < M_ ; ++ m )
-			markets_.emplace_back(caf::spawn_typed<Market>(H, this)) ;
+			markets_.emplace_back(caf::spawn_typed<Market>(H, this, flow_.on ? flow_.batch : 0, depths)) ;
 
-		// Spawn all the households in this economy. Each household needs the market addresses to
-		// send their the QUANT message.
-		households_.reserve(H) ;
-		for ( size_t h = 0 ; h < H ; ++ h ) {
+		// Households are grouped by utility family.
+		vector<utility::Family> family(H) ;
+		vector<vector<float>> params(H), endowments(H) ;
+		for ( size_t g = 0 ; g < families.size() ; ++ g )
+			for ( auto h = utility::group_begin(g, H, families.size()) ;
+			      h < utility::group_begin(g+1, H, families.size()) ; ++ h ) {
 
-			// Set up the 𝛼 parameter for each good.
-			vector<float> alphas ; alphas.reserve(M_) ;
-			for ( UInt m = 0 ; m < M ; ++ m )
-				alphas.emplace_back(ran_uni(rng)) ;
+				// Set up the parameters (the 𝛼 for each good for the CES family).
+				family[h] = families[g] ;
+				params[h] = utility::draw(family[h], rng, M_) ;
 
-			// Set up the initial endowment for each good.
-			vector<float> endowments ; endowments.reserve(M_) ;
-			for ( UInt m = 0 ; m < M_ ; ++ m )
-				endowments.emplace_back(100*ran_uni(rng)) ;
+				// Set up the initial endowment for each good.
+				endowments[h] = utility::draw_uniform(rng, M_, 100.) ;
+			}
 
-			households_.emplace_back(caf::spawn_typed<Household>(alphas, endowments, markets_)) ;
-		}
+		// Spawn all the households in this economy. Each household needs the market addresses to
+		// send their the QUANT message. The households copy their parameters on the NUMA node
+		// of the thread constructing them.
+		households_.resize(H) ;
+		placement::for_each_slice(place, H, [&](size_t begin, size_t end) {
+			for ( auto h = begin ; h < end ; ++ h )
+				households_[h] = spawn_household[family[h]](params[h], endowments[h], markets_, f32_, depths) ;
+		}) ;
 
-		iteration_init(), prices_.assign(M_, 1.) ;
+		iteration_init(), prices_.assign(M_, 1.), sent_prices_.assign(M_, 0.) ;
+		nr_iterations_ = 0, start_ = chrono::steady_clock::now() ;
 
 		// Send the initial prices to households.
-		for ( const auto & h : households_ )
-			send(h, price_a::value, prices_) ;
+		send_prices() ;
 	}
 protected :
 	behavior_type make_behavior() override {
 		return {
-			[&](pred_a, UInt m, double price, double red) { do_receive_pred(m, price, red) ; }
+			  [&](const PredMsg & msg) { do_receive_pred(msg.m, msg.price, msg.red, msg.depth) ; }
+			, [&](credit_a, UInt m) { do_receive_credit(m) ; }
 			} ;
 	}
 private:
 	UInt M_ ;
 	UInt H_ ;
+	const bool f32_ ;
+	const FlowControl flow_ ;
 	vector<double> prices_ ;
+	// Prices as rebuilt by the households from the deltas sent so far.
+	vector<double> sent_prices_ ;
 	size_t check_ ;
 	UInt nr_received_reds_ ;
 	double crit_ ;
+	const Periods periods_ ;
+	// Current period, number of iterations and start of the current period.
+	UInt t_ ;
+	UInt nr_iterations_ ;
+	chrono::steady_clock::time_point start_, iteration_start_ ;
+	default_random_engine shock_rng_ ;
+	// Message about prices of the current iteration, number of households it has been sent to
+	// and window of households not yet drained by the slowest market.
+	PriceMsg price_msg_ ;
+	UInt released_ ;
+	UInt window_ ;
+	// Quantities drained by each market and by the fastest one, as known from credits.
+	vector<UInt> drained_ ;
+	UInt max_drained_ ;
+	// Fewest quantities left to drain by a market since the last wave, as known from credits:
+	// they include the quantities of released households not sent yet.
+	UInt min_depth_ ;
+	// Peak depth of the deepest market mailbox and sum of the peak depths of the market
+	// mailboxes during the current iteration, as measured by the markets.
+	UInt max_queued_ ;
+	size_t sum_queued_ ;
 	vector<HouseholdAddr> households_ ;
 	vector<MarketAddr> markets_ ;
 
-	void do_receive_pred(UInt m, double price, double red) {
+	void do_receive_pred(UInt m, double price, double red, UInt depth) {
 		D(caf::aout(this) << "Supervisor receives price " << price <<
 		   " and relative excess demande " << red << " from market #" << m <<
 		   " -- nr_received_reds " << nr_received_reds_ << endl ;)
 		prices_[m] = price ;
 		check_ += m ;
 		crit_ += red*red ;
+		max_queued_ = max(max_queued_, depth), sum_queued_ += depth ;
 		if ( ++ nr_received_reds_ == M_ )
 			do_cont() ;
 	}
+	void do_receive_credit(UInt m) {
+		drained_[m] += flow_.batch ;
+		max_drained_ = max(max_drained_, drained_[m]) ;
+		min_depth_ = min(min_depth_, released_ - max_drained_) ;
+		// Room is freed in the window only when the slowest market drains a batch.
+		if ( released_ < H_ && *min_element(RANGE(drained_)) + window_ > released_ )
+			release_wave() ;
+	}
 	void do_cont() {
-		caf::aout(this) << "Supervisor evaluates crit " << crit_ << endl ;
+		const chrono::duration<double> elapsed = chrono::steady_clock::now() - iteration_start_ ;
+		// The peaks of the markets are not simultaneous: their sum bounds the quantities queued in
+		// all the mailboxes at once.
+		caf::aout(this) << "Supervisor evaluates crit " << crit_ << "\ttime " << elapsed.count() <<
+		   " s\tdeepest mailbox " << max_queued_ << " quantities\tall mailboxes at most " << sum_queued_ <<
+		   " quantities (" << sum_queued_*queued_quantity_size/(1024.*1024.) << " MiB)" << endl ;
 		// A simple way to partially check that each market sent a relative excess demand.
 		assert ( check_ == ((M_-1)*M_/2) ) ;
-		// Convergence achieved: send the stop signal to each market and to each household and dies.
+		++ nr_iterations_ ;
 		if ( crit_ < .0001 ) {
+			const chrono::duration<double> total = chrono::steady_clock::now() - start_ ;
+			caf::aout(this) << "Supervisor reaches equilibrium of period " << t_ << " after " <<
+			   nr_iterations_ << " iterations in " << total.count() << " s" << endl ;
+			if ( ++ t_ < periods_.T )
+				do_next_period() ;
+			else
+				do_stop() ;
+		}
+		else {
+			iteration_init() ;
+			send_prices() ;
+		}
+	}
+	// Shocks households and starts the next period with the same actors.
+	void do_next_period() {
+		bernoulli_distribution shocked(periods_.share) ;
+		for ( const auto & h : households_ )
+			if ( shocked(shock_rng_) )
+				send(h, shock_a::value, UInt(shock_rng_()), periods_.size) ;
+		if ( periods_.cold_start ) {
+			prices_.assign(M_, 1.) ;
 			for ( const auto & m : markets_ )
-				send(m, stop_a::value) ;
-			for ( const auto & h : households_ )
-				send(h, stop_a::value) ;
-			quit() ;
+				send(m, reset_a::value) ;
 		}
+		nr_iterations_ = 0, start_ = chrono::steady_clock::now() ;
+		iteration_init() ;
+		send_prices() ;
+	}
+	// Convergence achieved for the last period: send the stop signal to each market and to each
+	// household and dies.
+	void do_stop() {
+		for ( const auto & m : markets_ )
+			send(m, stop_a::value) ;
+		for ( const auto & h : households_ )
+			send(h, stop_a::value) ;
+		quit() ;
+	}
+	void send_prices() {
+		iteration_start_ = chrono::steady_clock::now() ;
+		price_msg_ = wire::make_price_msg(prices_, sent_prices_, f32_) ;
+		if ( flow_.on )
+			release_wave() ;
 		else {
+			released_ = H_ ;
 			for ( const auto & h : households_ )
-				send(h, price_a::value, prices_) ;
-			iteration_init() ;
+				send(h, price_msg_) ;
+		}
+	}
+	// Releases the households that fit in the window. The window grows by a batch when a market
+	// came within a batch of running out of quantities to drain since the last wave, and halves
+	// when every market kept more than half a window to drain: the markets stay busy with as few
+	// quantities in flight as their relative speeds allow. It stays between a batch, so that the slowest market always
+	// has a credit to return, and the target.
+	void release_wave() {
+		if ( released_ > 0 ) {
+			if ( min_depth_ < flow_.batch )
+				window_ = min(window_ + flow_.batch, max(flow_.target, flow_.batch)) ;
+			else if ( 2*min_depth_ > window_ )
+				window_ = max(window_/2, flow_.batch) ;
 		}
+		const auto end = min(*min_element(RANGE(drained_)) + window_, H_) ;
+		for ( ; released_ < end ; ++ released_ )
+			send(households_[released_], price_msg_) ;
+		min_depth_ = released_ - max_drained_ ;
 	}
 	void iteration_init() {
 		check_ = nr_received_reds_ = 0, crit_ = 0. ;
+		released_ = 0 ;
+		drained_.assign(M_, 0), max_drained_ = 0 ;
+		max_queued_ = 0, sum_queued_ = 0 ;
 	}
 } ;
 
-int main() {
+int main(int argc, char * argv[]) {
+
+	// With “--float32”, quantities are narrowed to float32 and price deltas are counted in a
+	// quantum of 2^-24 instead of 2^-40.
+	// With “--flow”, prices are broadcast in waves ; “--credit” sets the number of quantities
+	// per credit and “--target” the bound of the window.
+	// With “--families ces,leontief”, households are split evenly among the listed utility
+	// families (ces, cobb-douglas, leontief, nested-ces, stone-geary) ; a population mostly made of
+	// leontief households does not converge.
+	// With “--periods T”, T equilibria are solved in a row with the same actors: between two
+	// periods, the share “--shock-share” of households see their parameters and endowment drift
+	// by at most “--shock-size”, and the tâtonnement starts from the previous equilibrium prices,
+	// or from prices = 1 with “--cold-start”.
+	bool f32 = false ;
+	Periods periods{1, .1, .05, false} ;
+	FlowControl flow{false, 256, 4096} ;
+	placement::Options place ;
+	vector<utility::Family> families{utility::ces} ;
+	for ( int a = 1 ; a < argc ; ++ a ) {
+		if ( placement::parse_option(a, argc, argv, place) ) continue ;
+		if ( ! strcmp(argv[a], "--float32") ) f32 = true ;
+		else if ( ! strcmp(argv[a], "--flow") ) flow.on = true ;
+		else if ( ! strcmp(argv[a], "--credit") && a+1 < argc ) flow.batch = max(atoi(argv[++a]), 1) ;
+		else if ( ! strcmp(argv[a], "--target") && a+1 < argc ) flow.target = max(atoi(argv[++a]), 1) ;
+		else if ( ! strcmp(argv[a], "--families") && a+1 < argc ) families = utility::parse_families(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--periods") && a+1 < argc ) periods.T = max(atoi(argv[++a]), 1) ;
+		else if ( ! strcmp(argv[a], "--shock-share") && a+1 < argc ) periods.share = atof(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--shock-size") && a+1 < argc ) periods.size = atof(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--cold-start") ) periods.cold_start = true ;
+		else {
+			cerr << "usage: " << argv[0] << " [--float32] [--flow] [--credit N] [--target N]"
+			   " [--families ces,cobb-douglas,leontief,nested-ces,stone-geary]"
+			   " [--periods T] [--shock-share S] [--shock-size S] [--cold-start] " << placement::usage << endl <<
+			   utility::families_note << endl ;
+			return 1 ;
+		}
+	}
+	if ( families.empty() ) {
+		cerr << "Unknown utility family" << endl ;
+		return 1 ;
+	}
+	if ( ! placement::valid(place) )
+		return 1 ;
+
+	wire::announce_types() ;
+	placement::start_scheduler(place) ;
+	placement::bind_to_first_node(place) ;
 
 	constexpr UInt M = 100 ;
 	constexpr UInt H = 25*1000 ;
 	//~ constexpr UInt M = 2 ;
 	//~ constexpr UInt H = 3 ;
 
+	// Depth of the mailbox of each market ; outlives the actors.
+	vector<MailboxDepth> depths(M) ;
+
 	// Spawn the supervisor.
-	(void) caf::spawn_typed<Supervisor>(M, H) ;
+	(void) caf::spawn_typed<Supervisor>(M, H, f32, flow, place, families, periods, depths.data()) ;
 
 	caf::await_all_actors_done() ;
 	caf::shutdown() ;
@@ -0,0 +1,268 @@
+// coding: utf-8
+// Scheduler tuning, core pinning and NUMA-aware placement for the actor programs (Linux).
+//
+// CAF does not expose its worker threads nor an affinity between actors and workers: an actor
+// runs on the worker that schedules it, or on a worker that steals it. What can be controlled is
+//  * the number of workers and the number of messages an actor handles per run (throughput) ;
+//  * the cores the workers are pinned to ;
+//  * the NUMA node holding the state of each actor: memory is allocated on the node of the
+//    thread touching it first, so actors constructed from a thread bound to a node keep their
+//    parameters on that node. The “numa” placement spreads the households over the nodes of the
+//    pinned workers, in proportion to their number of workers, so that no household lives on a
+//    node without workers. It does not choose the worker running an household, which may be on
+//    another node: the locality gained is only statistical.
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <caf/all.hpp>
+
+typedef unsigned int UInt ;
+
+namespace placement {
+
+struct Options {
+	// Number of workers of the scheduler, 0 for one per core.
+	UInt workers = 0 ;
+	// Number of messages an actor handles before giving its worker back, 0 for no limit.
+	UInt throughput = 0 ;
+	// Pinning of the workers: “none”, “compact” (fill a node before the next one) or “scatter”
+	// (round robin over the nodes).
+	std::string pin = "none" ;
+	// Placement of the memory of the actors: “none” (all constructed from the main thread) or
+	// “numa” (households spread over the nodes of the pinned workers, markets and supervisor on
+	// the node of the first worker) ; “numa” requires pinning.
+	std::string placement = "none" ;
+} ;
+
+// Tells whether “value” is one of the “n” names.
+inline bool one_of(const char * value, const char * const names[], UInt n) {
+	for ( UInt k = 0 ; k < n ; ++ k )
+		if ( ! strcmp(value, names[k]) )
+			return true ;
+	return false ;
+}
+
+static const char * const pin_names[] = { "none", "compact", "scatter" } ;
+static const char * const placement_names[] = { "none", "numa" } ;
+
+// Parses the option at argv[a] if it is a placement option with a valid value, advancing “a”
+// past its value.
+inline bool parse_option(int & a, int argc, char * argv[], Options & opt) {
+	if ( a+1 >= argc )
+		return false ;
+	if ( ! strcmp(argv[a], "--workers") ) opt.workers = std::max(atoi(argv[++a]), 1) ;
+	else if ( ! strcmp(argv[a], "--throughput") ) opt.throughput = std::max(atoi(argv[++a]), 0) ;
+	else if ( ! strcmp(argv[a], "--pin") ) {
+		if ( ! one_of(argv[a+1], pin_names, 3) ) {
+			std::cerr << "Unknown pinning policy " << argv[a+1] << std::endl ;
+			return false ;
+		}
+		opt.pin = argv[++a] ;
+	}
+	else if ( ! strcmp(argv[a], "--placement") ) {
+		if ( ! one_of(argv[a+1], placement_names, 2) ) {
+			std::cerr << "Unknown placement policy " << argv[a+1] << std::endl ;
+			return false ;
+		}
+		opt.placement = argv[++a] ;
+	}
+	else return false ;
+	return true ;
+}
+
+// Checks the options taken together.
+inline bool valid(const Options & opt) {
+	if ( opt.placement == "numa" && opt.pin == "none" ) {
+		std::cerr << "The numa placement requires --pin compact or --pin scatter" << std::endl ;
+		return false ;
+	}
+	return true ;
+}
+
+constexpr const char * usage = "[--workers N] [--throughput N] [--pin none|compact|scatter] [--placement none|numa]" ;
+
+// Parses a cpulist such as “0-3,8-11”.
+inline std::vector<int> parse_cpulist(const std::string & list) {
+	std::vector<int> cpus ;
+	std::istringstream in(list) ;
+	std::string range ;
+	while ( getline(in, range, ',') ) {
+		if ( range.empty() || range == "\n" )
+			continue ;
+		const auto dash = range.find('-') ;
+		const auto first = atoi(range.c_str()) ;
+		const auto last = (dash == std::string::npos) ? first : atoi(range.c_str()+dash+1) ;
+		for ( auto c = first ; c <= last ; ++ c )
+			cpus.push_back(c) ;
+	}
+	return cpus ;
+}
+
+// CPUs of each NUMA node ; a single node with all the CPUs if the topology is not available.
+inline std::vector<std::vector<int>> numa_nodes() {
+	std::vector<std::vector<int>> nodes ;
+	for ( UInt n = 0 ; ; ++ n ) {
+		std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist") ;
+		if ( ! in )
+			break ;
+		std::string list ;
+		getline(in, list) ;
+		const auto cpus = parse_cpulist(list) ;
+		if ( ! cpus.empty() )
+			nodes.push_back(cpus) ;
+	}
+	if ( nodes.empty() ) {
+		nodes.emplace_back() ;
+		for ( UInt c = 0 ; c < std::max(std::thread::hardware_concurrency(), 1u) ; ++ c )
+			nodes[0].push_back(c) ;
+	}
+	return nodes ;
+}
+
+// Binds the thread “tid” (the calling thread if 0) to the given CPUs.
+inline void pin_thread(pid_t tid, const std::vector<int> & cpus) {
+	cpu_set_t set ;
+	CPU_ZERO(&set) ;
+	for ( const auto c : cpus )
+		CPU_SET(c, &set) ;
+	if ( sched_setaffinity(tid, sizeof(set), &set) != 0 )
+		std::cerr << "Cannot pin thread " << tid << ": " << strerror(errno) << std::endl ;
+}
+
+// Order in which the workers are given a core.
+inline std::vector<int> core_order(const std::vector<std::vector<int>> & nodes, const std::string & pin) {
+	std::vector<int> cores ;
+	if ( pin == "scatter" ) {
+		for ( size_t i = 0 ; ; ++ i ) {
+			bool any = false ;
+			for ( const auto & node : nodes )
+				if ( i < node.size() )
+					cores.push_back(node[i]), any = true ;
+			if ( ! any )
+				break ;
+		}
+	}
+	else
+		for ( const auto & node : nodes )
+			cores.insert(cores.end(), node.begin(), node.end()) ;
+	return cores ;
+}
+
+// Identifiers of the “workers” workers of the scheduler. Actors spawned from outside the
+// scheduler are dispatched to the workers in turn: each of these records the thread it runs on
+// and holds its worker until all the workers have been seen, so that no worker runs two of them.
+// The other threads of the scheduler (timer, printer) are not seen.
+inline std::vector<pid_t> worker_threads(UInt workers) {
+	std::mutex mtx ;
+	std::condition_variable seen ;
+	std::vector<pid_t> tids ;
+	for ( UInt w = 0 ; w < workers ; ++ w )
+		caf::spawn([&] {
+			std::unique_lock<std::mutex> lock(mtx) ;
+			tids.push_back(syscall(SYS_gettid)) ;
+			seen.notify_all() ;
+			seen.wait_for(lock, std::chrono::seconds(1), [&] { return tids.size() >= workers ; }) ;
+		}) ;
+	caf::await_all_actors_done() ;
+	sort(tids.begin(), tids.end()) ;
+	tids.erase(unique(tids.begin(), tids.end()), tids.end()) ;
+	return tids ;
+}
+
+inline UInt nr_workers(const Options & opt) {
+	return opt.workers ? opt.workers : std::max(std::thread::hardware_concurrency(), 1u) ;
+}
+
+// Number of workers pinned on each node: the w-th worker is pinned to the w-th core of the
+// order of the pinning policy.
+inline std::vector<size_t> workers_per_node(const Options & opt, const std::vector<std::vector<int>> & nodes) {
+	std::vector<size_t> counts(nodes.size(), 0) ;
+	const auto cores = core_order(nodes, opt.pin) ;
+	for ( UInt w = 0 ; w < nr_workers(opt) ; ++ w ) {
+		const auto core = cores[w % cores.size()] ;
+		for ( size_t k = 0 ; k < nodes.size() ; ++ k )
+			if ( find(nodes[k].begin(), nodes[k].end(), core) != nodes[k].end() )
+				++ counts[k] ;
+	}
+	return counts ;
+}
+
+// Sets up the scheduler ; must be called before any actor is spawned. The workers are pinned
+// one per core ; the other threads of the scheduler are left free.
+inline void start_scheduler(const Options & opt) {
+	const auto workers = nr_workers(opt) ;
+	if ( opt.throughput )
+		caf::set_scheduler<>(workers, opt.throughput) ;
+	else
+		caf::set_scheduler<>(workers) ;
+	if ( opt.pin == "none" )
+		return ;
+	const auto cores = core_order(numa_nodes(), opt.pin) ;
+	const auto tids = worker_threads(workers) ;
+	if ( tids.size() < workers )
+		std::cerr << "Only " << tids.size() << " workers out of " << workers << " found to pin" << std::endl ;
+	for ( size_t w = 0 ; w < tids.size() ; ++ w )
+		pin_thread(tids[w], {cores[w % cores.size()]}) ;
+}
+
+// Calls f(begin, end) on contiguous slices of [0, n). With the “numa” placement, there is one
+// slice per node with pinned workers, proportional to their number, handled by a thread bound
+// to that node ; otherwise f(0, n) is called from the calling thread.
+template <class F>
+void for_each_slice(const Options & opt, size_t n, F f) {
+	if ( opt.placement != "numa" ) {
+		f(0, n) ;
+		return ;
+	}
+	const auto nodes = numa_nodes() ;
+	const auto counts = workers_per_node(opt, nodes) ;
+	const auto workers = nr_workers(opt) ;
+	std::vector<std::thread> spawners ;
+	size_t begin = 0, seen = 0 ;
+	for ( size_t k = 0 ; k < nodes.size() ; ++ k ) {
+		if ( ! counts[k] )
+			continue ;
+		seen += counts[k] ;
+		const auto end = n*seen/workers ;
+		const auto & node = nodes[k] ;
+		spawners.emplace_back([=, &node] { pin_thread(0, node) ; f(begin, end) ; }) ;
+		begin = end ;
+	}
+	for ( auto & t : spawners )
+		t.join() ;
+}
+
+// Binds the calling thread, with the “numa” placement, to the node of the first worker, so that
+// the state of the actors it constructs (supervisor and markets) is allocated on that node.
+inline void bind_to_first_node(const Options & opt) {
+	if ( opt.placement != "numa" )
+		return ;
+	const auto nodes = numa_nodes() ;
+	const auto counts = workers_per_node(opt, nodes) ;
+	for ( size_t k = 0 ; k < nodes.size() ; ++ k )
+		if ( counts[k] ) {
+			pin_thread(0, nodes[k]) ;
+			return ;
+		}
+}
+
+}
+
+#endif
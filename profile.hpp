@@ -0,0 +1,171 @@
+// coding: utf-8
+// Profiling of the phases of the reference engine (Linux).
+//
+// Each phase is wrapped in a scope which accumulates its wall time and, when the kernel lets us
+// open them with perf_event_open, the hardware counters of the calling thread: cycles,
+// instructions, cache misses and branch misses. Counters are reported per phase and per
+// iteration with the derived instructions per cycle (IPC) and bytes fetched from memory per
+// household (cache misses × cache line). A high IPC with few bytes means the phase is
+// compute-bound, a low IPC with many bytes that it is memory-bound.
+// The figures describe the code as compiled: the makefile builds reference with -O2 so that the
+// kernels are inlined as in a production run.
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+typedef unsigned int UInt ;
+
+namespace profile {
+
+enum Phase { setup, shock, sweep, aggregation, update, nr_phases } ;
+
+static const char * const phase_names[nr_phases] = { "setup", "shock", "sweep", "aggregation", "update" } ;
+
+enum Counter { cycles, instructions, cache_misses, branch_misses, nr_counters } ;
+
+constexpr UInt cache_line = 64 ;
+
+// Wall time and counters accumulated by a phase.
+struct Sample {
+	double seconds = 0. ;
+	uint64_t counts[nr_counters] = { } ;
+	Sample & operator+=(const Sample & other) {
+		seconds += other.seconds ;
+		for ( UInt c = 0 ; c < nr_counters ; ++ c )
+			counts[c] += other.counts[c] ;
+		return *this ;
+	}
+} ;
+
+// Group of hardware counters of the calling thread, opened if “open”.
+class Counters {
+public:
+	Counters(bool open) {
+		if ( ! open )
+			return ;
+		static const uint64_t configs[nr_counters] = {
+			PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+		} ;
+		for ( UInt c = 0 ; c < nr_counters ; ++ c ) {
+			perf_event_attr attr ;
+			memset(&attr, 0, sizeof(attr)) ;
+			attr.size = sizeof(attr) ;
+			attr.type = PERF_TYPE_HARDWARE ;
+			attr.config = configs[c] ;
+			attr.read_format = PERF_FORMAT_GROUP ;
+			attr.disabled = (c == 0) ;
+			attr.exclude_kernel = 1 ;
+			attr.exclude_hv = 1 ;
+			fds_[c] = syscall(__NR_perf_event_open, &attr, 0, -1, (c == 0) ? -1 : fds_[0], 0) ;
+			if ( fds_[c] < 0 ) {
+				close_all() ;
+				return ;
+			}
+		}
+		ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) ;
+	}
+	~Counters() { close_all() ; }
+	Counters(const Counters &) = delete ;
+	Counters & operator=(const Counters &) = delete ;
+	bool available() const { return fds_[0] >= 0 ; }
+	// Reads the current values of the counters, all zero if they are not available.
+	void read(uint64_t counts[nr_counters]) const {
+		struct { uint64_t nr ; uint64_t values[nr_counters] ; } data = { } ;
+		if ( available() && ::read(fds_[0], &data, sizeof(data)) == sizeof(data) )
+			memcpy(counts, data.values, sizeof(data.values)) ;
+		else
+			memset(counts, 0, sizeof(data.values)) ;
+	}
+private:
+	int fds_[nr_counters] = { -1, -1, -1, -1 } ;
+	void close_all() {
+		for ( auto & fd : fds_ )
+			if ( fd >= 0 )
+				close(fd), fd = -1 ;
+	}
+} ;
+
+class Profiler {
+public:
+	// A disabled profiler costs a test per scope.
+	Profiler(bool on) : on_(on), counters_(on) {
+		if ( on_ && ! counters_.available() )
+			std::cout << "profile\thardware counters unavailable, timers only" << std::endl ;
+	}
+	// Accumulates the time and the counters spent in its lifetime into the phase “phase”.
+	class Scope {
+	public:
+		Scope(Profiler & profiler, Phase phase) : profiler_(profiler), phase_(phase) {
+			if ( profiler_.on_ ) {
+				profiler_.counters_.read(start_counts_) ;
+				start_ = std::chrono::steady_clock::now() ;
+			}
+		}
+		~Scope() {
+			if ( ! profiler_.on_ )
+				return ;
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_ ;
+			Sample sample ;
+			sample.seconds = elapsed.count() ;
+			profiler_.counters_.read(sample.counts) ;
+			for ( UInt c = 0 ; c < nr_counters ; ++ c )
+				sample.counts[c] -= start_counts_[c] ;
+			profiler_.iteration_[phase_] += sample ;
+			profiler_.total_[phase_] += sample ;
+		}
+	private:
+		Profiler & profiler_ ;
+		const Phase phase_ ;
+		std::chrono::steady_clock::time_point start_ ;
+		uint64_t start_counts_[nr_counters] ;
+	} ;
+	// Reports, under the label “when”, the phases run since the previous call for a population
+	// of H households.
+	void flush(const std::string & when, UInt H) {
+		if ( ! on_ )
+			return ;
+		for ( UInt p = 0 ; p < nr_phases ; ++ p )
+			if ( iteration_[p].seconds > 0. )
+				print(when, static_cast<Phase>(p), iteration_[p], H) ;
+		for ( auto & sample : iteration_ )
+			sample = Sample() ;
+	}
+	// Reports the totals of the phases.
+	void report(UInt H) const {
+		if ( ! on_ )
+			return ;
+		for ( UInt p = 0 ; p < nr_phases ; ++ p )
+			print("total", static_cast<Phase>(p), total_[p], H) ;
+	}
+private:
+	const bool on_ ;
+	Counters counters_ ;
+	Sample iteration_[nr_phases], total_[nr_phases] ;
+	void print(const std::string & when, Phase phase, const Sample & sample, UInt H) const {
+		std::cout << "profile\t" << when << "\t" << std::setw(11) << std::left << phase_names[phase] <<
+		   std::right << "\ttime " << sample.seconds << " s" ;
+		if ( counters_.available() ) {
+			const auto & n = sample.counts ;
+			std::cout << "\tcycles " << n[cycles] << "\tinstructions " << n[instructions] <<
+			   "\tcache-misses " << n[cache_misses] << "\tbranch-misses " << n[branch_misses] <<
+			   "\tIPC " << (n[cycles] ? double(n[instructions])/n[cycles] : 0.) <<
+			   "\tbytes/household " << double(n[cache_misses])*cache_line/H ;
+		}
+		std::cout << std::endl ;
+	}
+} ;
+
+}
+
+#endif
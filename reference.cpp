@@ -6,6 +6,11 @@
 #include <cmath>
 #include <numeric>
 #include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include "utility.hpp"
+#include "profile.hpp"
 
 #define DEBUG(arg) std::cout << #arg "\t" << (arg) << std::endl ;
 
@@ -13,40 +18,6 @@ typedef unsigned int UInt ;
 
 using namespace std ;
 
-class Household {
-public:
-	// Constructor for an household.
-	Household(UInt nr, const vector<float> & alphas, const vector<float> & endowments)
-	   : nr_(nr), alphas_(alphas), endowments_(endowments) {
-		assert( alphas_.size() == endowments_.size() ) ;
-	}
-	// This function returns the vector of supplies (if < 0) or demands (if >= 0) of this
-	// houselhold for the prices given by the “prices” argument.
-	vector<float> supplies_or_demands(const vector<double> & prices) const ;
-	UInt nr() const { return nr_ ; }
-private:
-	UInt nr_ ;
-	vector<float> alphas_ ;
-	vector<float> endowments_ ;
-} ;
-
-vector<float> Household::supplies_or_demands(const vector<double> & prices) const {
-	const auto I = prices.size() ;
-	assert( I == alphas_.size() ) ;
-	constexpr auto sig = 2. ;
-	// First term to compute the general level of prices for this household.
-	const auto sum = inner_product( prices.begin(), prices.end(), alphas_.begin(), 0.,
-	   plus<double>(), [=] (double p, double alpha) { return pow(alpha, sig) * pow(p, 1.-sig) ; } ) ;
-	// General level of prices for this household.
-	const auto P = pow(sum, 1./(1.-sig)) ;
-	// Value of initial endowment, i.e. revenu of consummer.
-	const auto R = inner_product(prices.begin(), prices.end(), endowments_.begin(), 0.) ;
-	vector<float> tmp ; tmp.reserve(I) ;
-	for ( UInt i = 0 ; i <= I ; ++ i )
-		tmp.emplace_back(pow(alphas_[i], sig) * pow(prices[i]/P, -sig) * R/P - endowments_[i]) ;
-	return tmp ;
-}
-
 class Market {
 public:
 	Market(UInt nr, UInt H) : nr_(nr), quantities_(H) { } 
@@ -68,7 +39,86 @@ double Market::relative_excess_demand() const {
 	return (demand + supply) / ((-supply+demand)/2) ;
 }
 
-int main() {
+// The households sharing the utility family “U”. Their parameters and endowments are stored
+// household after household, so that the sweep over the population runs the inlined kernel of
+// its family.
+template <class U>
+class Population {
+public:
+	Population(UInt I) : I_(I) { }
+	void add(UInt nr, const vector<float> & params, const vector<float> & endowments) {
+		assert( params.size() == U::nr_params*I_ ) ;
+		assert( endowments.size() == I_ ) ;
+		nrs_.push_back(nr) ;
+		params_.insert(params_.end(), params.begin(), params.end()) ;
+		endowments_.insert(endowments_.end(), endowments.begin(), endowments.end()) ;
+	}
+	// This function sets on each market the supply (if < 0) or the demand (if >= 0) of each
+	// household of this population for the prices given by the “prices” argument.
+	void supplies_or_demands(const vector<double> & prices, vector<Market> & markets) const ;
+	// This function shocks each household of this population with probability “share”: its
+	// parameters and its endowment drift by at most “size” in relative terms.
+	void shock(default_random_engine & rng, double share, double size) ;
+private:
+	const UInt I_ ;
+	vector<UInt> nrs_ ;
+	vector<float> params_ ;
+	vector<float> endowments_ ;
+} ;
+
+template <class U>
+void Population<U>::supplies_or_demands(const vector<double> & prices, vector<Market> & markets) const {
+	assert( prices.size() == I_ && markets.size() == I_ ) ;
+	for ( size_t h = 0 ; h < nrs_.size() ; ++ h ) {
+		const auto nr = nrs_[h] ;
+		U::demand(prices.data(), &params_[h*U::nr_params*I_], &endowments_[h*I_], I_,
+		   [&](UInt i, double q) { markets[i].set_supply_or_demand(q, nr) ; }) ;
+	}
+}
+
+template <class U>
+void Population<U>::shock(default_random_engine & rng, double share, double size) {
+	bernoulli_distribution shocked(share) ;
+	for ( size_t h = 0 ; h < nrs_.size() ; ++ h )
+		if ( shocked(rng) ) {
+			utility::drift(rng, size, &params_[h*U::nr_params*I_], U::nr_params*I_) ;
+			utility::drift(rng, size, &endowments_[h*I_], I_) ;
+		}
+}
+
+int main(int argc, char * argv[]) {
+
+	// With “--families ces,leontief”, households are split evenly among the listed utility
+	// families (ces, cobb-douglas, leontief, nested-ces, stone-geary) ; a population mostly made of
+	// leontief households does not converge.
+	// With “--profile”, the time and hardware counters of each phase are reported.
+	// With “--periods T”, T equilibria are solved in a row: between two periods, the share
+	// “--shock-share” of households see their parameters and endowment drift by at most
+	// “--shock-size”, and the tâtonnement starts from the previous equilibrium prices, or from
+	// prices = 1 with “--cold-start”.
+	vector<utility::Family> families{utility::ces} ;
+	bool profiling = false ;
+	UInt T = 1 ;
+	double shock_share = .1, shock_size = .05 ;
+	bool cold_start = false ;
+	for ( int a = 1 ; a < argc ; ++ a ) {
+		if ( ! strcmp(argv[a], "--families") && a+1 < argc ) families = utility::parse_families(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--profile") ) profiling = true ;
+		else if ( ! strcmp(argv[a], "--periods") && a+1 < argc ) T = max(atoi(argv[++a]), 1) ;
+		else if ( ! strcmp(argv[a], "--shock-share") && a+1 < argc ) shock_share = atof(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--shock-size") && a+1 < argc ) shock_size = atof(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--cold-start") ) cold_start = true ;
+		else {
+			cerr << "usage: " << argv[0] << " [--families ces,cobb-douglas,leontief,nested-ces,stone-geary]"
+			   " [--profile] [--periods T] [--shock-share S] [--shock-size S] [--cold-start]" << endl <<
+			   utility::families_note << endl ;
+			return 1 ;
+		}
+	}
+	if ( families.empty() ) {
+		cerr << "Unknown utility family" << endl ;
+		return 1 ;
+	}
 
 	//~ constexpr UInt H = 10*1000 ;
 	//~ constexpr UInt I = 100 ;
@@ -78,54 +128,108 @@ int main() {
 
 
 	default_random_engine rng ;
-	uniform_real_distribution<double> ran_uni ;
 
-	// Populate the economy.
-	vector<Household> houselholds ; houselholds.reserve(H) ;
-	for ( UInt h = 0 ; h < H ; ++ h ) {
+	profile::Profiler profiler(profiling) ;
 
-		// Set up the 𝛼 for each good.
-		vector<float> alphas ; alphas.reserve(I) ;
-		for ( UInt i = 0 ; i < I ; ++ i )
-			alphas.emplace_back(ran_uni(rng)) ;
+	// Populate the economy, grouping the households by utility family.
+	Population<utility::CES> ces(I) ;
+	Population<utility::CobbDouglas> cobb_douglas(I) ;
+	Population<utility::Leontief> leontief(I) ;
+	Population<utility::NestedCES> nested_ces(I) ;
+	Population<utility::StoneGeary> stone_geary(I) ;
+	vector<Market> markets ; markets.reserve(I) ;
+	{
+		const profile::Profiler::Scope scope(profiler, profile::setup) ;
+		for ( size_t g = 0 ; g < families.size() ; ++ g ) {
+			const auto f = families[g] ;
+			const auto end = utility::group_begin(g+1, H, families.size()) ;
+			for ( UInt h = utility::group_begin(g, H, families.size()) ; h < end ; ++ h ) {
+
+				// Set up the parameters (the 𝛼 for each good for the CES family).
+				const auto params = utility::draw(f, rng, I) ;
+
+				// Set up the initial endowment for each good.
+				const auto endowments = utility::draw_uniform(rng, I, 100.) ;
+
+				switch ( f ) {
+					case utility::ces : ces.add(h, params, endowments) ; break ;
+					case utility::cobb_douglas : cobb_douglas.add(h, params, endowments) ; break ;
+					case utility::leontief : leontief.add(h, params, endowments) ; break ;
+					case utility::nested_ces : nested_ces.add(h, params, endowments) ; break ;
+					case utility::stone_geary : stone_geary.add(h, params, endowments) ; break ;
+					default : assert( false ) ;
+				}
+			}
+		}
 
-		// Set up the initial endowment for each good.
-		vector<float> endowments ; endowments.reserve(I) ;
+		// Create the markets.
 		for ( UInt i = 0 ; i < I ; ++ i )
-			endowments.emplace_back(100*ran_uni(rng)) ;
-
-		houselholds.emplace_back(h, alphas, endowments) ;
+			markets.emplace_back(i, H) ;
 	}
-
-	// Create the markets.
-	vector<Market> markets ; markets.reserve(I) ;
-	for ( UInt i = 0 ; i < I ; ++ i )
-		markets.emplace_back(i, H) ;
-
-	// Walrasian tâtonnement.
+	profiler.flush("setup", H) ;
 
 	vector<double> prices(I, 1.) ;
+	vector<double> reds(I) ;
 
-	for ( UInt s = 0 ; s < 100 ; ++ s ) {
+	for ( UInt t = 0 ; t < T ; ++ t ) {
 
-		for ( const auto & household : houselholds ) {
-			const auto q = household.supplies_or_demands(prices) ;
-			for ( UInt i = 0 ; i < I ; ++ i )
-				markets[i].set_supply_or_demand(q[i], household.nr()) ;
+		const auto start = chrono::steady_clock::now() ;
+
+		if ( t > 0 ) {
+			const profile::Profiler::Scope scope(profiler, profile::shock) ;
+			ces.shock(rng, shock_share, shock_size) ;
+			cobb_douglas.shock(rng, shock_share, shock_size) ;
+			leontief.shock(rng, shock_share, shock_size) ;
+			nested_ces.shock(rng, shock_share, shock_size) ;
+			stone_geary.shock(rng, shock_share, shock_size) ;
+			if ( cold_start )
+				prices.assign(I, 1.) ;
 		}
 
-		double crit = 0. ;
-		for ( UInt i = 0 ; i < I ; ++ i ) {
-			const auto red = markets[i].relative_excess_demand() ;
-			// Price update with respect to relative excess demand.
-			prices[i] = prices[i] * (1.+.25*red) ;
-			crit += red*red ;
+		// Walrasian tâtonnement, warm-started from the equilibrium prices of the previous period.
+
+		UInt s = 0 ;
+		while ( s < 100 ) {
+
+			{
+				// Each population runs the kernel of its family.
+				const profile::Profiler::Scope scope(profiler, profile::sweep) ;
+				ces.supplies_or_demands(prices, markets) ;
+				cobb_douglas.supplies_or_demands(prices, markets) ;
+				leontief.supplies_or_demands(prices, markets) ;
+				nested_ces.supplies_or_demands(prices, markets) ;
+				stone_geary.supplies_or_demands(prices, markets) ;
+			}
+
+			{
+				const profile::Profiler::Scope scope(profiler, profile::aggregation) ;
+				for ( UInt i = 0 ; i < I ; ++ i )
+					reds[i] = markets[i].relative_excess_demand() ;
+			}
+
+			double crit = 0. ;
+			{
+				const profile::Profiler::Scope scope(profiler, profile::update) ;
+				for ( UInt i = 0 ; i < I ; ++ i ) {
+					// Price update with respect to relative excess demand.
+					prices[i] = prices[i] * (1.+.25*reds[i]) ;
+					crit += reds[i]*reds[i] ;
+				}
+			}
+			profiler.flush("period " + to_string(t) + " iteration " + to_string(s), H) ;
+			DEBUG(crit)
+			++ s ;
+			if ( crit < .0001 )
+				break ;
+
 		}
-		DEBUG(crit)
-		if ( crit < .0001 )
-			break ;
+
+		const chrono::duration<double> elapsed = chrono::steady_clock::now() - start ;
+		cout << "period " << t << "\titerations " << s << "\ttime " << elapsed.count() << " s" << endl ;
 
 	}
 
+	profiler.report(H) ;
+
 	return 0 ;
 }
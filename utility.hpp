@@ -0,0 +1,223 @@
+// coding: utf-8
+// Utility families of the households.
+//
+// Each family is a policy class the engines instantiate at compile time, so that the demand
+// kernel is inlined in the sweep over the households of that family. A family provides
+//  * nr_params, the number of parameters per good: the k-th parameter of good i of an household
+//    is params[k*I + i] ;
+//  * draw(rng, I), which draws the parameters of an household ;
+//  * demand(prices, params, endowments, I, out), which calls out(i, q) with the supply (if q < 0)
+//    or the demand (if q >= 0) of good i.
+#ifndef UTILITY_HPP
+#define UTILITY_HPP
+
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <sstream>
+#include <vector>
+
+typedef unsigned int UInt ;
+
+namespace utility {
+
+// Value of initial endowment, i.e. revenu of consummer.
+inline double income(const double * prices, const float * endowments, UInt I) {
+	double R = 0. ;
+	for ( UInt i = 0 ; i < I ; ++ i )
+		R += prices[i] * endowments[i] ;
+	return R ;
+}
+
+// Draws “n” parameters uniformly in [0, scale).
+inline std::vector<float> draw_uniform(std::default_random_engine & rng, UInt n, double scale = 1.) {
+	std::uniform_real_distribution<double> ran_uni ;
+	std::vector<float> params ; params.reserve(n) ;
+	for ( UInt k = 0 ; k < n ; ++ k )
+		params.emplace_back(scale*ran_uni(rng)) ;
+	return params ;
+}
+
+// u(q) = (∑ 𝛼_i q_i^((𝜎-1)/𝜎))^(𝜎/(𝜎-1)).
+struct CES {
+	static constexpr UInt nr_params = 1 ;
+	static constexpr double sig = 2. ;
+	static std::vector<float> draw(std::default_random_engine & rng, UInt I) {
+		return draw_uniform(rng, I) ;
+	}
+	static double price_index(const double * prices, const float * alphas, UInt I) {
+		double sum = 0. ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			sum += pow(alphas[i], sig) * pow(prices[i], 1.-sig) ;
+		return pow(sum, 1./(1.-sig)) ;
+	}
+	template <class Out>
+	static void demand(const double * prices, const float * alphas, const float * endowments, UInt I, Out out) {
+		const auto P = price_index(prices, alphas, I) ;
+		const auto R = income(prices, endowments, I) ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			out(i, pow(alphas[i], sig) * pow(prices[i]/P, -sig) * R/P - endowments[i]) ;
+	}
+} ;
+
+// u(q) = ∏ q_i^𝛼_i : the household spends the share 𝛼_i/∑𝛼 of its income on good i.
+struct CobbDouglas {
+	static constexpr UInt nr_params = 1 ;
+	static std::vector<float> draw(std::default_random_engine & rng, UInt I) {
+		return draw_uniform(rng, I) ;
+	}
+	template <class Out>
+	static void demand(const double * prices, const float * alphas, const float * endowments, UInt I, Out out) {
+		double A = 0. ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			A += alphas[i] ;
+		const auto R = income(prices, endowments, I) ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			out(i, alphas[i]/A * R/prices[i] - endowments[i]) ;
+	}
+} ;
+
+// u(q) = min q_i/𝛼_i : goods are consumed in fixed proportions. Since a price change only moves
+// the demands through the incomes, the tâtonnement of the engines, which relies on goods being
+// substitutes, does not converge for a population mostly made of such households: some prices
+// fall towards zero, the excess supply of these goods remains, and the engines stop at their
+// iteration cap.
+struct Leontief {
+	static constexpr UInt nr_params = 1 ;
+	static std::vector<float> draw(std::default_random_engine & rng, UInt I) {
+		return draw_uniform(rng, I) ;
+	}
+	static double price_index(const double * prices, const float * alphas, UInt I) {
+		double P = 0. ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			P += alphas[i] * prices[i] ;
+		return P ;
+	}
+	template <class Out>
+	static void demand(const double * prices, const float * alphas, const float * endowments, UInt I, Out out) {
+		const auto P = price_index(prices, alphas, I) ;
+		const auto R = income(prices, endowments, I) ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			out(i, alphas[i] * R/P - endowments[i]) ;
+	}
+} ;
+
+// CES of CES: goods are grouped in nests of “nest_size” consecutive goods, substitutable with
+// elasticity sig_in within a nest ; nests are substitutable with elasticity sig_out.
+struct NestedCES {
+	static constexpr UInt nr_params = 1 ;
+	static constexpr UInt nest_size = 10 ;
+	static constexpr double sig_in = 3. ;
+	static constexpr double sig_out = 1.5 ;
+	static std::vector<float> draw(std::default_random_engine & rng, UInt I) {
+		return draw_uniform(rng, I) ;
+	}
+	// General level of prices of the nest [begin, end).
+	static double nest_price_index(const double * prices, const float * alphas, UInt begin, UInt end) {
+		double sum = 0. ;
+		for ( UInt i = begin ; i < end ; ++ i )
+			sum += pow(alphas[i], sig_in) * pow(prices[i], 1.-sig_in) ;
+		return pow(sum, 1./(1.-sig_in)) ;
+	}
+	static double price_index(const double * prices, const float * alphas, UInt I) {
+		double sum = 0. ;
+		for ( UInt begin = 0 ; begin < I ; begin += nest_size )
+			sum += pow(nest_price_index(prices, alphas, begin, std::min(begin+nest_size, I)), 1.-sig_out) ;
+		return pow(sum, 1./(1.-sig_out)) ;
+	}
+	template <class Out>
+	static void demand(const double * prices, const float * alphas, const float * endowments, UInt I, Out out) {
+		const auto P = price_index(prices, alphas, I) ;
+		const auto R = income(prices, endowments, I) ;
+		for ( UInt begin = 0 ; begin < I ; begin += nest_size ) {
+			const auto end = std::min(begin+nest_size, I) ;
+			const auto P_k = nest_price_index(prices, alphas, begin, end) ;
+			// Real expenditure on the nest.
+			const auto E_k = pow(P_k/P, -sig_out) * R/P ;
+			for ( UInt i = begin ; i < end ; ++ i )
+				out(i, pow(alphas[i], sig_in) * pow(prices[i]/P_k, -sig_in) * E_k - endowments[i]) ;
+		}
+	}
+} ;
+
+// u(q) = ∑ 𝛽_i log(q_i - 𝛾_i) : the household first buys the subsistence quantities 𝛾, then
+// spends the share 𝛽_i/∑𝛽 of the remaining income on good i. The parameters are the 𝛽 followed
+// by the 𝛾.
+struct StoneGeary {
+	static constexpr UInt nr_params = 2 ;
+	static std::vector<float> draw(std::default_random_engine & rng, UInt I) {
+		auto params = draw_uniform(rng, I) ;
+		// Subsistence quantities, in [0, 10), are small with respect to endowments, in [0, 100).
+		const auto gammas = draw_uniform(rng, I, 10.) ;
+		params.insert(params.end(), gammas.begin(), gammas.end()) ;
+		return params ;
+	}
+	template <class Out>
+	static void demand(const double * prices, const float * params, const float * endowments, UInt I, Out out) {
+		const auto betas = params, gammas = params + I ;
+		double B = 0., subsistence = 0. ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			B += betas[i], subsistence += prices[i] * gammas[i] ;
+		const auto R = income(prices, endowments, I) - subsistence ;
+		for ( UInt i = 0 ; i < I ; ++ i )
+			out(i, gammas[i] + betas[i]/B * R/prices[i] - endowments[i]) ;
+	}
+} ;
+
+// Drifts the “n” values at “x”: each one is multiplied by a factor drawn uniformly in
+// [1-size, 1+size). Used to shock the parameters and the endowment of an household between two
+// periods.
+inline void drift(std::default_random_engine & rng, double size, float * x, size_t n) {
+	std::uniform_real_distribution<double> ran_uni(1.-size, 1.+size) ;
+	for ( size_t k = 0 ; k < n ; ++ k )
+		x[k] *= ran_uni(rng) ;
+}
+
+enum Family { ces, cobb_douglas, leontief, nested_ces, stone_geary, nr_families } ;
+
+static const char * const family_names[nr_families] = {
+	"ces", "cobb-douglas", "leontief", "nested-ces", "stone-geary"
+} ;
+
+// Printed with the usage of the programs.
+constexpr const char * families_note =
+   "  leontief households consume goods in fixed proportions: the tâtonnement does not converge\n"
+   "  for a population mostly made of them and stops at the iteration cap." ;
+
+// Parses a comma separated list of family names ; returns an empty list if a name is unknown.
+inline std::vector<Family> parse_families(const std::string & list) {
+	std::vector<Family> families ;
+	std::istringstream in(list) ;
+	std::string name ;
+	while ( getline(in, name, ',') ) {
+		UInt f = 0 ;
+		while ( f < nr_families && name != family_names[f] )
+			++ f ;
+		if ( f == nr_families )
+			return { } ;
+		families.push_back(static_cast<Family>(f)) ;
+	}
+	return families ;
+}
+
+// The H households are split evenly among the families, in contiguous groups: this is the first
+// household of the group “g” out of “nr_groups”.
+inline size_t group_begin(size_t g, size_t H, size_t nr_groups) {
+	return H*g/nr_groups ;
+}
+
+// Draws the parameters of an household of the family “f”.
+inline std::vector<float> draw(Family f, std::default_random_engine & rng, UInt I) {
+	switch ( f ) {
+		case cobb_douglas : return CobbDouglas::draw(rng, I) ;
+		case leontief : return Leontief::draw(rng, I) ;
+		case nested_ces : return NestedCES::draw(rng, I) ;
+		case stone_geary : return StoneGeary::draw(rng, I) ;
+		default : return CES::draw(rng, I) ;
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+// coding: utf-8
+// Loopback benchmark of the wire layout of the simulation messages.
+//
+// The program forks: the child publishes a sink actor on a local TCP port, the parent connects
+// to it and plays, at each iteration, the traffic a remote node of actor-model-II would send:
+// one price vector for M goods and H quantities. The layout is either “legacy” (the atoms and
+// the builtin types serialized by CAF) or “compact” (the types of wire.hpp).
+//
+// The bytes per iteration are those acknowledged on the TCP connection to the sink, so they
+// include the headers of BASP (the protocol of CAF between nodes) ; the serialized payload of
+// the messages alone is reported beside them.
+//
+//   ./wire-bench [legacy|compact] [--float32] [--port P] [--iterations S] [--goods M] [--households H]
+#include <iostream>
+#include <cassert>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <dirent.h>
+#include <caf/all.hpp>
+#include <caf/io/all.hpp>
+#include "wire.hpp"
+
+#define DEBUG(arg) std::cout << #arg "\t" << (arg) << std::endl ;
+
+using namespace std ;
+
+typedef unsigned int UInt ;
+
+// The messages of actor-model-II before the compact layout.
+using price_a = caf::atom_constant<caf::atom("PRICE")>;
+using quant_a = caf::atom_constant<caf::atom("QUANT")>;
+// Message sent by the client at the end of the run ; the sink replies with the number of
+// messages it received.
+using done_a = caf::atom_constant<caf::atom("DONE")>;
+
+// The tcp_info of the C library stops before the byte counters the kernel appends to it since
+// Linux 4.1 ; linux/tcp.h cannot be included along with netinet/tcp.h.
+struct TcpInfo {
+	tcp_info base ;
+	uint64_t pacing_rate, max_pacing_rate, bytes_acked ;
+} ;
+
+// Socket of this process connected to the local port “port”, -1 if there is none.
+int connected_socket(uint16_t port) {
+	int fd = -1 ;
+	if ( auto dir = opendir("/proc/self/fd") ) {
+		while ( auto entry = readdir(dir) ) {
+			if ( entry->d_name[0] == '.' )
+				continue ;
+			sockaddr_in peer ;
+			socklen_t len = sizeof(peer) ;
+			const auto candidate = atoi(entry->d_name) ;
+			if ( getpeername(candidate, reinterpret_cast<sockaddr *>(&peer), &len) == 0
+			     && peer.sin_family == AF_INET && ntohs(peer.sin_port) == port ) {
+				fd = candidate ;
+				break ;
+			}
+		}
+		closedir(dir) ;
+	}
+	return fd ;
+}
+
+// Number of bytes sent on the socket “fd” and acknowledged by the peer, -1 if not available.
+int64_t bytes_acked(int fd) {
+	TcpInfo info ;
+	socklen_t len = sizeof(info) ;
+	if ( fd < 0 || getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0 || len < sizeof(info) )
+		return -1 ;
+	return info.bytes_acked ;
+}
+
+// The sink counts every message it receives and dies after the DONE message.
+caf::behavior sink(caf::event_based_actor * self, uint64_t * count) {
+	return {
+		  [=](price_a, const vector<double> &) { ++ *count ; }
+		, [=](quant_a, UInt, double) { ++ *count ; }
+		, [=](const PriceMsg &) { ++ *count ; }
+		, [=](const QuantMsg &) { ++ *count ; }
+		, [=](done_a) { self->quit() ; return *count ; }
+	} ;
+}
+
+int main(int argc, char * argv[]) {
+
+	bool compact = true, f32 = false ;
+	uint16_t port = 4242 ;
+	UInt S = 100, M = 100, H = 1000 ;
+	for ( int a = 1 ; a < argc ; ++ a ) {
+		if ( ! strcmp(argv[a], "legacy") ) compact = false ;
+		else if ( ! strcmp(argv[a], "compact") ) compact = true ;
+		else if ( ! strcmp(argv[a], "--float32") ) f32 = true ;
+		else if ( ! strcmp(argv[a], "--port") && a+1 < argc ) port = atoi(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--iterations") && a+1 < argc ) S = atoi(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--goods") && a+1 < argc ) M = atoi(argv[++a]) ;
+		else if ( ! strcmp(argv[a], "--households") && a+1 < argc ) H = atoi(argv[++a]) ;
+		else {
+			cerr << "usage: " << argv[0] << " [legacy|compact] [--float32] [--port P]"
+			   " [--iterations S] [--goods M] [--households H]" << endl ;
+			return 1 ;
+		}
+	}
+
+	// Fork before CAF starts any thread.
+	const auto pid = fork() ;
+	if ( pid < 0 ) {
+		perror("fork") ;
+		return 1 ;
+	}
+
+	wire::announce_types() ;
+
+	if ( pid == 0 ) {
+		uint64_t count = 0 ;
+		caf::io::publish(caf::spawn(sink, &count), port, "127.0.0.1") ;
+		caf::await_all_actors_done() ;
+		caf::shutdown() ;
+		return 0 ;
+	}
+
+	// Wait for the child to publish the sink.
+	caf::actor remote ;
+	for ( UInt attempt = 0 ; ! remote && attempt < 100 ; ++ attempt ) {
+		try {
+			remote = caf::io::remote_actor("127.0.0.1", port) ;
+		}
+		catch ( const exception & ) {
+			this_thread::sleep_for(chrono::milliseconds(50)) ;
+		}
+	}
+	if ( ! remote ) {
+		cerr << "Cannot connect to the sink on port " << port << endl ;
+		kill(pid, SIGTERM) ;
+		return 1 ;
+	}
+
+	const auto fd = connected_socket(port) ;
+	size_t payload = 0 ;
+	int64_t wire_bytes = -1 ;
+	chrono::duration<double> elapsed ;
+	{
+		caf::scoped_actor self ;
+
+		// Plays the S iterations. If “send”, messages go to the sink ; otherwise only their
+		// serialized size is accounted, out of the timed run.
+		auto play = [&](bool send) {
+			default_random_engine rng ;
+			uniform_real_distribution<double> ran_uni ;
+			// Prices drift as during a tâtonnement: relative changes shrinking with the iterations.
+			vector<double> prices(M, 1.), sent(M, 0.) ;
+			vector<double> quantities(H) ;
+			for ( auto & q : quantities )
+				q = 100*(ran_uni(rng)-.5) ;
+			for ( UInt s = 0 ; s < S ; ++ s ) {
+				for ( auto & p : prices )
+					p *= 1. + (ran_uni(rng)-.5)/(s+1) ;
+				if ( compact ) {
+					const auto msg = wire::make_price_msg(prices, sent, f32) ;
+					if ( send ) self->send(remote, msg) ;
+					else payload += wire::serialized_size(msg) ;
+					for ( UInt h = 0 ; h < H ; ++ h ) {
+						const QuantMsg q{f32, h, quantities[h]} ;
+						if ( send ) self->send(remote, q) ;
+						else payload += wire::serialized_size(q) ;
+					}
+				}
+				else {
+					if ( send ) self->send(remote, price_a::value, prices) ;
+					else payload += wire::serialized_size(price_a::value, prices) ;
+					for ( UInt h = 0 ; h < H ; ++ h ) {
+						if ( send ) self->send(remote, quant_a::value, h, quantities[h]) ;
+						else payload += wire::serialized_size(quant_a::value, h, quantities[h]) ;
+					}
+				}
+			}
+		} ;
+
+		play(false) ;
+		const auto acked = bytes_acked(fd) ;
+		const auto start = chrono::steady_clock::now() ;
+		play(true) ;
+		// The reply acknowledges all the bytes sent before the DONE message, which is counted
+		// with the traffic of the iterations.
+		self->sync_send(remote, done_a::value).await(
+			[&](uint64_t count) { assert ( count == uint64_t(S)*(H+1) ) ; }
+		) ;
+		elapsed = chrono::steady_clock::now() - start ;
+		if ( acked >= 0 )
+			wire_bytes = bytes_acked(fd) - acked ;
+	}
+
+	cout << (compact ? "compact" : "legacy") << (f32 ? " float32" : "")
+	   << "\tbytes/iteration " ;
+	if ( wire_bytes >= 0 )
+		cout << double(wire_bytes)/S ;
+	else
+		cout << "n/a" ;
+	cout << "\tpayload bytes/iteration " << double(payload)/S
+	   << "\tmessages/s " << S*(H+1)/elapsed.count() << endl ;
+
+	caf::shutdown() ;
+	waitpid(pid, nullptr, 0) ;
+
+	return 0 ;
+}
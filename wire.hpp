@@ -0,0 +1,218 @@
+// coding: utf-8
+// Compact wire layout for the messages exchanged by the actors of actor-model-II.
+//
+// By default, CAF serializes every element of a message with its type name, so a quantity
+// message (atom, UInt, double) costs far more bytes in type tags than in payload. Each message
+// of the simulation is here a single announced type whose serializer writes a compact binary
+// layout:
+//  * household and market numbers are written as varints ;
+//  * prices travel as deltas against the prices of the previous iteration, counted in a fixed
+//    quantum and written as zigzag varints: since prices move less and less along the
+//    tâtonnement, a delta takes a few bytes, a null one a single byte ;
+//  * with “f32”, quantities are narrowed to float32 and the quantum of the deltas is coarser.
+#ifndef WIRE_HPP
+#define WIRE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <caf/all.hpp>
+
+typedef unsigned int UInt ;
+
+// Message about prices : sent by the supervisor and received by households. It carries the
+// change of each price since the previous message, so that the receiver rebuilds the prices
+// by accumulation: an household must receive all the messages, in order (CAF keeps the order of
+// the messages between two actors). The first message is a delta against zero prices. The
+// deltas are multiples of quantum(f32).
+struct PriceMsg {
+	bool f32 ;
+	std::vector<double> deltas ;
+} ;
+inline bool operator==(const PriceMsg & a, const PriceMsg & b) {
+	return a.f32 == b.f32 && a.deltas == b.deltas ;
+}
+
+// Message about quantity : sent by an household and received by a market.
+struct QuantMsg {
+	bool f32 ;
+	UInt h ;
+	double q ;
+} ;
+inline bool operator==(const QuantMsg & a, const QuantMsg & b) {
+	return a.f32 == b.f32 && a.h == b.h && a.q == b.q ;
+}
+
+// Message about price and relative excess demande : sent by a market and received by the supervisor,
+// with the peak number of quantities waiting in the mailbox of the market during the iteration.
+struct PredMsg {
+	UInt m ;
+	double price ;
+	double red ;
+	UInt depth ;
+} ;
+inline bool operator==(const PredMsg & a, const PredMsg & b) {
+	return a.m == b.m && a.price == b.price && a.red == b.red && a.depth == b.depth ;
+}
+
+namespace wire {
+
+inline void write_varint(caf::serializer * sink, uint64_t x) {
+	uint8_t buf[10] ;
+	size_t n = 0 ;
+	while ( x >= 0x80 ) {
+		buf[n++] = static_cast<uint8_t>(x) | 0x80 ;
+		x >>= 7 ;
+	}
+	buf[n++] = static_cast<uint8_t>(x) ;
+	sink->write_raw(n, buf) ;
+}
+
+inline uint64_t read_varint(caf::deserializer * source) {
+	uint64_t x = 0 ;
+	for ( UInt shift = 0 ; shift < 64 ; shift += 7 ) {
+		uint8_t byte ;
+		source->read_raw(1, &byte) ;
+		x |= static_cast<uint64_t>(byte & 0x7f) << shift ;
+		if ( ! (byte & 0x80) )
+			break ;
+	}
+	return x ;
+}
+
+// Quantum of the price deltas: 2^-24 (the precision of a float32 around 1) if “f32”, 2^-40
+// otherwise. Households know the prices within half a quantum ; prices are assumed below 2^20
+// so that a delta counted in quanta fits in 64 bits.
+inline double quantum(bool f32) {
+	return f32 ? std::ldexp(1., -24) : std::ldexp(1., -40) ;
+}
+
+// Signed integers are mapped to unsigned ones of the same magnitude (0, -1, 1, -2, …) before
+// being written as varints.
+inline uint64_t zigzag(int64_t x) {
+	return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63) ;
+}
+
+inline int64_t unzigzag(uint64_t x) {
+	return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1) ;
+}
+
+// A real number is written with 4 bytes if “f32”, with 8 bytes otherwise.
+inline void write_real(caf::serializer * sink, double x, bool f32) {
+	if ( f32 ) {
+		const auto y = static_cast<float>(x) ;
+		sink->write_raw(sizeof(y), &y) ;
+	}
+	else
+		sink->write_raw(sizeof(x), &x) ;
+}
+
+inline double read_real(caf::deserializer * source, bool f32) {
+	if ( f32 ) {
+		float y ;
+		source->read_raw(sizeof(y), &y) ;
+		return y ;
+	}
+	double x ;
+	source->read_raw(sizeof(x), &x) ;
+	return x ;
+}
+
+// Layout: varint (n << 1 | f32), then the n deltas in quanta as zigzag varints.
+class PriceMsgInfo : public caf::detail::abstract_uniform_type_info<PriceMsg> {
+public:
+	PriceMsgInfo() : caf::detail::abstract_uniform_type_info<PriceMsg>("PriceMsg") { }
+protected:
+	void serialize(const void * ptr, caf::serializer * sink) const override {
+		const auto & x = deref(ptr) ;
+		write_varint(sink, (static_cast<uint64_t>(x.deltas.size()) << 1) | x.f32) ;
+		const auto q = quantum(x.f32) ;
+		for ( const auto d : x.deltas )
+			write_varint(sink, zigzag(std::llround(d/q))) ;
+	}
+	void deserialize(void * ptr, caf::deserializer * source) const override {
+		auto & x = deref(ptr) ;
+		const auto head = read_varint(source) ;
+		x.f32 = head & 1 ;
+		x.deltas.resize(head >> 1) ;
+		const auto q = quantum(x.f32) ;
+		for ( auto & d : x.deltas )
+			d = unzigzag(read_varint(source)) * q ;
+	}
+} ;
+
+// Layout: varint (h << 1 | f32), then the quantity.
+class QuantMsgInfo : public caf::detail::abstract_uniform_type_info<QuantMsg> {
+public:
+	QuantMsgInfo() : caf::detail::abstract_uniform_type_info<QuantMsg>("QuantMsg") { }
+protected:
+	void serialize(const void * ptr, caf::serializer * sink) const override {
+		const auto & x = deref(ptr) ;
+		write_varint(sink, (static_cast<uint64_t>(x.h) << 1) | x.f32) ;
+		write_real(sink, x.q, x.f32) ;
+	}
+	void deserialize(void * ptr, caf::deserializer * source) const override {
+		auto & x = deref(ptr) ;
+		const auto head = read_varint(source) ;
+		x.f32 = head & 1 ;
+		x.h = static_cast<UInt>(head >> 1) ;
+		x.q = read_real(source, x.f32) ;
+	}
+} ;
+
+// Layout: varint m, then the price and the relative excess demand, always in double precision
+// since the supervisor drives the convergence criterion with them, then varint depth.
+class PredMsgInfo : public caf::detail::abstract_uniform_type_info<PredMsg> {
+public:
+	PredMsgInfo() : caf::detail::abstract_uniform_type_info<PredMsg>("PredMsg") { }
+protected:
+	void serialize(const void * ptr, caf::serializer * sink) const override {
+		const auto & x = deref(ptr) ;
+		write_varint(sink, x.m) ;
+		write_real(sink, x.price, false) ;
+		write_real(sink, x.red, false) ;
+		write_varint(sink, x.depth) ;
+	}
+	void deserialize(void * ptr, caf::deserializer * source) const override {
+		auto & x = deref(ptr) ;
+		x.m = static_cast<UInt>(read_varint(source)) ;
+		x.price = read_real(source, false) ;
+		x.red = read_real(source, false) ;
+		x.depth = static_cast<UInt>(read_varint(source)) ;
+	}
+} ;
+
+// Registers the compact serializers ; must be called before any actor is spawned.
+inline void announce_types() {
+	caf::announce(typeid(PriceMsg), caf::uniform_type_info_ptr{new PriceMsgInfo}) ;
+	caf::announce(typeid(QuantMsg), caf::uniform_type_info_ptr{new QuantMsgInfo}) ;
+	caf::announce(typeid(PredMsg), caf::uniform_type_info_ptr{new PredMsgInfo}) ;
+}
+
+// Builds the price message from “prices” and updates “sent”, the prices as rebuilt by the
+// receivers. The delta is rounded to the quantum in process, so that local and remote receivers
+// get the same values, and against the rebuilt prices, so that the rounding does not drift.
+inline PriceMsg make_price_msg(const std::vector<double> & prices, std::vector<double> & sent, bool f32) {
+	const auto q = quantum(f32) ;
+	PriceMsg msg{f32, std::vector<double>(prices.size())} ;
+	for ( size_t m = 0 ; m < prices.size() ; ++ m ) {
+		const auto d = std::llround((prices[m] - sent[m])/q) * q ;
+		msg.deltas[m] = d ;
+		sent[m] += d ;
+	}
+	return msg ;
+}
+
+// Number of bytes of the payload of a message, as written by CAF’s binary serializer.
+template <class... Ts>
+size_t serialized_size(const Ts &... xs) {
+	std::vector<char> buf ;
+	caf::binary_serializer bs(std::back_inserter(buf)) ;
+	bs << caf::make_message(xs...) ;
+	return buf.size() ;
+}
+
+}
+
+#endif